@@ -1,9 +1,14 @@
+#include <execution>
 #include <fmt/format.h>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <numeric>
 #include <ranges>
 #include <set>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "grid.hpp"
 #include "vec2.hpp"
@@ -117,11 +122,163 @@ struct Schema {
     }
 };
 
+// Rolling three row scanner: numbers never span rows, so the rows directly
+// above and below are all that is needed to find parts and gears of a row.
+// Memory use is O(width), and no number ids need to be tracked.
+struct RowScanner {
+    static char at(const std::string_view row, const int64_t x) {
+        if (x < 0 or x >= std::ssize(row)) {
+            return '.';
+        }
+        return row[static_cast<size_t>(x)];
+    }
+
+    static bool isSymbol(const char c) { return c != '.' and !std::isdigit(c); }
+
+    // parse the number covering row[x]
+    static int64_t numberAt(const std::string_view row, int64_t x) {
+        while (std::isdigit(at(row, x - 1))) {
+            --x;
+        }
+        int64_t number = 0;
+        for (; std::isdigit(at(row, x)); ++x) {
+            number = number * 10 + (at(row, x) - '0');
+        }
+        return number;
+    }
+
+    // sum of all part numbers in row current
+    static int64_t partSum(const std::string_view above, const std::string_view current,
+                           const std::string_view below) {
+        int64_t sum = 0;
+        int64_t x = 0;
+        while (x < std::ssize(current)) {
+            if (!std::isdigit(at(current, x))) {
+                ++x;
+                continue;
+            }
+            const auto start = x;
+            int64_t number = 0;
+            for (; std::isdigit(at(current, x)); ++x) {
+                number = number * 10 + (at(current, x) - '0');
+            }
+            // x is now one past the number
+            for (const auto nx : iota(start - 1, x + 1)) {
+                if (isSymbol(at(above, nx)) or isSymbol(at(current, nx)) or
+                    isSymbol(at(below, nx))) {
+                    sum += number;
+                    break;
+                }
+            }
+        }
+        return sum;
+    }
+
+    // sum of all gear ratios of the '*' in row current
+    static int64_t gearSum(const std::string_view above, const std::string_view current,
+                           const std::string_view below) {
+        int64_t ratioSum = 0;
+        for (const auto x : iota(0, std::ssize(current))) {
+            if (at(current, x) != '*') {
+                continue;
+            }
+            int64_t adjacent = 0;
+            int64_t ratio = 1;
+            for (const auto row : {above, current, below}) {
+                for (const auto nx : iota(x - 1, x + 2)) {
+                    // count each number only at its leftmost adjacent digit
+                    if (std::isdigit(at(row, nx)) and
+                        (nx == x - 1 or !std::isdigit(at(row, nx - 1)))) {
+                        ++adjacent;
+                        if (adjacent <= 2) {
+                            ratio *= numberAt(row, nx);
+                        }
+                    }
+                }
+            }
+            if (adjacent == 2) {
+                ratioSum += ratio;
+            }
+        }
+        return ratioSum;
+    }
+};
+
+void streamSchema(const char *filename) {
+    std::ifstream infile{filename};
+    std::string above{};
+    std::string current{};
+    std::string below{};
+    int64_t sum = 0;
+    int64_t ratioSum = 0;
+
+    bool haveCurrent = static_cast<bool>(std::getline(infile, current));
+    while (haveCurrent) {
+        const bool haveBelow = static_cast<bool>(std::getline(infile, below));
+        if (!haveBelow) {
+            below.clear();
+        }
+        sum += RowScanner::partSum(above, current, below);
+        ratioSum += RowScanner::gearSum(above, current, below);
+        std::swap(above, current);
+        std::swap(current, below);
+        haveCurrent = haveBelow;
+    }
+    fmt::print("The engine parts sum to {}\n", sum);
+    fmt::print("The gear ratios sum to {}\n", ratioSum);
+}
+
+// Split the schematic into horizontal bands and scan them in parallel. Each
+// band reads one halo row above and below, but only counts numbers and gears
+// of its own rows, so nothing at the band edges is counted twice.
+void parallelSchema(const char *filename) {
+    const Grid<char> schematic{filename, '.'};
+    const auto row = [&schematic](const int64_t y) -> std::string_view {
+        if (y < 0 or y >= schematic.height) {
+            return {};
+        }
+        return {schematic.data.data() + schematic.index(0, y),
+                static_cast<size_t>(schematic.width)};
+    };
+
+    constexpr int64_t bandHeight = 32;
+    std::vector<int64_t> bands(
+        static_cast<size_t>((schematic.height + bandHeight - 1) / bandHeight));
+    std::iota(bands.begin(), bands.end(), 0);
+
+    const auto [sum, ratioSum] = std::transform_reduce(
+        std::execution::par, bands.begin(), bands.end(), std::pair<int64_t, int64_t>{0, 0},
+        [](const auto &a, const auto &b) {
+            return std::pair{a.first + b.first, a.second + b.second};
+        },
+        [&](const int64_t band) {
+            std::pair<int64_t, int64_t> bandSum{0, 0};
+            for (const auto y : iota(band * bandHeight,
+                                     std::min((band + 1) * bandHeight, schematic.height))) {
+                bandSum.first += RowScanner::partSum(row(y - 1), row(y), row(y + 1));
+                bandSum.second += RowScanner::gearSum(row(y - 1), row(y), row(y + 1));
+            }
+            return bandSum;
+        });
+    fmt::print("The engine parts sum to {}\n", sum);
+    fmt::print("The gear ratios sum to {}\n", ratioSum);
+}
+
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [stream|parallel]\n";
         std::exit(EXIT_FAILURE);
     }
+    const std::string mode = argc == 3 ? argv[2] : "";
+
+    if (mode == "stream") {
+        streamSchema(argv[1]);
+        return 0;
+    }
+    if (mode == "parallel") {
+        parallelSchema(argv[1]);
+        return 0;
+    }
 
     Schema broken{argv[1]};
     // broken.print();
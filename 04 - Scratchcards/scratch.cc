@@ -1,15 +1,120 @@
+#include <bitset>
 #include <fmt/format.h>
 #include <functional>
 #include <iostream>
-#include <queue>
 #include <ranges>
-#include <set>
 #include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "simpleparser.hpp"
 
 using std::views::iota;
 
+// Card numbers are small, so winning and drawn numbers are kept as 128 bit
+// masks and matched with a single popcount. Numbers outside of the masks
+// fall back to a hash set.
+struct CardMatcher {
+    static constexpr int64_t maskBits = 128;
+    std::bitset<maskBits> winning{};
+    std::bitset<maskBits> drawn{};
+    std::unordered_set<int64_t> wideWinning{};
+    // wins not visible in the masks: wide numbers and repeated draws
+    int64_t extraWins = 0;
+
+    static bool inMask(const int64_t number) { return number >= 0 and number < maskBits; }
+
+    void clear() {
+        winning.reset();
+        drawn.reset();
+        wideWinning.clear();
+        extraWins = 0;
+    }
+
+    void addWinning(const int64_t number) {
+        if (inMask(number)) {
+            winning.set(static_cast<size_t>(number));
+        } else {
+            wideWinning.insert(number);
+        }
+    }
+
+    void addDrawn(const int64_t number) {
+        if (inMask(number)) {
+            const auto bit = static_cast<size_t>(number);
+            if (drawn[bit] and winning[bit]) {
+                ++extraWins;
+            }
+            drawn.set(bit);
+        } else if (wideWinning.contains(number)) {
+            ++extraWins;
+        }
+    }
+
+    int64_t wins() const { return static_cast<int64_t>((winning & drawn).count()) + extraWins; }
+};
+
+// Won copies are kept as a difference array over the following cards. A card
+// can only pass copies to as many cards ahead as it has wins, so a ring buffer
+// of the largest win count is enough to process any number of cards.
+struct CopyTracker {
+    std::vector<int64_t> delta{0, 0};
+    int64_t currentId = 0;
+    int64_t running = 0;
+
+    size_t slot(const int64_t id) const { return static_cast<size_t>(id) % delta.size(); }
+
+    // Move on to card id and return how many copies of it we hold. After one
+    // turn around the ring every pending change is applied, so a gap in the
+    // card ids costs at most the ring size.
+    int64_t take(const int64_t id) {
+        const auto end = std::min(id, currentId + std::ssize(delta));
+        while (currentId < end) {
+            ++currentId;
+            running += std::exchange(delta[slot(currentId)], 0);
+        }
+        currentId = std::max(currentId, id);
+        return 1 + running;
+    }
+
+    // cards currentId+1 .. currentId+size-1 may be pending, keep them on resize
+    void reserve(const int64_t wins) {
+        const auto size = static_cast<size_t>(wins + 2);
+        if (size <= delta.size()) {
+            return;
+        }
+        std::vector<int64_t> grown(size, 0);
+        for (const auto id : iota(currentId + 1, currentId + std::ssize(delta))) {
+            grown[static_cast<size_t>(id) % size] = delta[slot(id)];
+        }
+        delta = std::move(grown);
+    }
+
+    // the current card passes count copies to each of the next wins cards
+    void win(const int64_t count, const int64_t wins) {
+        if (wins == 0) {
+            return;
+        }
+        reserve(wins);
+        delta[slot(currentId + 1)] += count;
+        delta[slot(currentId + wins + 1)] -= count;
+    }
+
+    // copies won for cards after the current one
+    std::vector<std::pair<int64_t, int64_t>> pending() const {
+        std::vector<std::pair<int64_t, int64_t>> cards{};
+        auto copies = running;
+        for (const auto id : iota(currentId + 1, currentId + std::ssize(delta))) {
+            copies += delta[slot(id)];
+            if (copies != 0) {
+                cards.emplace_back(id, copies);
+            }
+        }
+        return cards;
+    }
+};
+
 int main(int argc, char **argv) {
     if (argc != 2) {
         std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
@@ -17,46 +122,36 @@ int main(int argc, char **argv) {
     }
 
     SimpleParser scanner{argv[1]};
-    std::priority_queue<std::pair<int64_t, int64_t>> wonCards{};
-    std::set<int64_t> winningNumbers{};
+    CopyTracker wonCards{};
+    CardMatcher matcher{};
     int64_t totalScore = 0;
     int64_t totalCards = 0;
     while (!scanner.isEof()) {
         scanner.getToken();
         const auto cardId = scanner.getInt64();
-        int64_t cardCount = 1;
-        while (!wonCards.empty() and wonCards.top().first == -cardId) {
-            cardCount += wonCards.top().second;
-            wonCards.pop();
-        }
+        const auto cardCount = wonCards.take(cardId);
         scanner.skipChar(':');
-        winningNumbers.clear();
+        matcher.clear();
         while (!scanner.skipChar('|')) {
-            winningNumbers.insert(scanner.getInt64());
+            matcher.addWinning(scanner.getInt64());
         }
-        int64_t wins = 0;
         while (!scanner.isEof() and std::isdigit(scanner.peekChar())) {
-            const auto number = scanner.getInt64();
-            if (winningNumbers.contains(number)) {
-                ++wins;
-            }
+            matcher.addDrawn(scanner.getInt64());
         }
+        const auto wins = matcher.wins();
         const auto points = wins > 0 ? 1 << (wins - 1) : 0;
         totalScore += points;
 
-        for (const auto wonId : iota(cardId + 1, cardId + wins + 1)) {
-            wonCards.emplace(-wonId, cardCount);
-        }
+        wonCards.win(cardCount, wins);
         totalCards += cardCount;
     }
     fmt::print("You have {} points\n", totalScore);
     fmt::print("You have {} cards\n", totalCards);
-    if (wonCards.size() > 0) {
-        fmt::print("Somehow you still have {} card packs:\n", wonCards.size());
-        while (wonCards.size() > 0) {
-            const auto &[game, num] = wonCards.top();
-            fmt::print("    {} cards with number {}\n", num, -game);
-            wonCards.pop();
+    const auto leftCards = wonCards.pending();
+    if (leftCards.size() > 0) {
+        fmt::print("Somehow you still have {} card packs:\n", leftCards.size());
+        for (const auto &[game, num] : leftCards) {
+            fmt::print("    {} cards with number {}\n", num, game);
         }
     }
 }
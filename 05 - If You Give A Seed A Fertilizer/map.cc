@@ -1,11 +1,15 @@
 #include <algorithm>
 #include <cctype>
+#include <execution>
 #include <fmt/format.h>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <numeric>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -14,6 +18,22 @@
 using std::views::iota;
 using LocationRange = std::pair<int64_t, int64_t>;
 
+// merge overlapping and adjacent ranges of a sorted range list
+void coalesce(std::vector<LocationRange> &ranges) {
+    if (ranges.empty()) {
+        return;
+    }
+    auto last = ranges.begin();
+    for (auto it = std::next(ranges.begin()); it != ranges.end(); ++it) {
+        if (it->first <= last->first + last->second) {
+            last->second = std::max(last->second, it->first + it->second - last->first);
+        } else {
+            *++last = *it;
+        }
+    }
+    ranges.erase(std::next(last), ranges.end());
+}
+
 struct Mapper {
     struct Mapping {
         int64_t dst;
@@ -34,38 +54,33 @@ struct Mapper {
         std::sort(mapping.begin(), mapping.end());
     }
 
+    // mapping is sorted by src, so all lookups are binary searches
     int64_t map(const int64_t from) const {
-        for (const auto &[d, s, l] : mapping) {
-            if (from >= s and from < s + l) {
-                return from - s + d;
-            }
+        const auto current = rangeLeft(from);
+        if (current and from < current->src + current->len) {
+            return from - current->src + current->dst;
         }
         return from;
     }
 
     // range may include location
     std::optional<Mapping> rangeLeft(const int64_t location) const {
-        if (mapping.front().src > location) {
+        const auto right = std::ranges::upper_bound(mapping, location, {}, &Mapping::src);
+        if (right == mapping.begin()) {
             return {};
         }
-        for (const auto i : iota(1u, mapping.size())) {
-            if (mapping[i].src > location) {
-                return mapping[i - 1];
-            }
-        }
-        return mapping.back();
+        return *std::prev(right);
     }
     // range after location
     std::optional<Mapping> rangeRight(const int64_t location) const {
-        for (const auto &map : mapping) {
-            if (map.src > location) {
-                return map;
-            }
+        const auto right = std::ranges::upper_bound(mapping, location, {}, &Mapping::src);
+        if (right == mapping.end()) {
+            return {};
         }
-        return {};
+        return *right;
     }
 
-    std::vector<LocationRange> map(const std::vector<LocationRange> &from) const {
+    std::vector<LocationRange> map(std::span<const LocationRange> from) const {
         std::vector<LocationRange> to{};
         for (const auto &srcRange : from) {
             auto currentSrc = srcRange.first;
@@ -97,17 +112,126 @@ struct Mapper {
             }
         }
         std::sort(to.begin(), to.end());
+        coalesce(to);
+        return to;
+    }
+
+    // map chunks of the input in parallel, then merge the sorted results
+    std::vector<LocationRange> mapParallel(const std::vector<LocationRange> &from) const {
+        constexpr size_t chunkSize = 1024;
+        const auto chunks = (from.size() + chunkSize - 1) / chunkSize;
+        if (chunks <= 1) {
+            return map(from);
+        }
+        std::vector<std::vector<LocationRange>> parts(chunks);
+        std::vector<size_t> chunkIds(chunks);
+        std::iota(chunkIds.begin(), chunkIds.end(), 0);
+        std::for_each(std::execution::par, chunkIds.begin(), chunkIds.end(), [&](const size_t i) {
+            const auto first = i * chunkSize;
+            parts[i] =
+                map(std::span{from}.subspan(first, std::min(chunkSize, from.size() - first)));
+        });
+
+        std::vector<LocationRange> to{};
+        std::vector<size_t> bounds{0};
+        for (const auto &part : parts) {
+            to.insert(to.end(), part.begin(), part.end());
+            bounds.push_back(to.size());
+        }
+        for (size_t width = 1; width < chunks; width *= 2) {
+            for (size_t i = 0; i + width < chunks; i += 2 * width) {
+                std::inplace_merge(to.begin() + static_cast<int64_t>(bounds[i]),
+                                   to.begin() + static_cast<int64_t>(bounds[i + width]),
+                                   to.begin() + static_cast<int64_t>(
+                                                    bounds[std::min(i + 2 * width, chunks)]));
+            }
+        }
+        coalesce(to);
         return to;
     }
 };
 
+// All stages of the almanac composed into one piecewise linear function.
+// Piece i maps [start_i, start_i+1) by adding offset_i, the first piece
+// starts at 0 and the last one is open ended. Locations are never negative,
+// so every image is covered by the pieces of the next stage.
+struct PiecewiseMap {
+    struct Piece {
+        int64_t start;
+        int64_t offset;
+    };
+    std::vector<Piece> pieces{{0, 0}};
+
+    PiecewiseMap() = default;
+    explicit PiecewiseMap(const Mapper &mapper) {
+        pieces.clear();
+        int64_t next = 0;
+        for (const auto &[d, s, l] : mapper.mapping) {
+            if (s > next) {
+                push(next, 0);
+            }
+            push(s, d - s);
+            next = s + l;
+        }
+        push(next, 0);
+    }
+
+    // append a piece, dropping empty pieces and merging equal offsets
+    void push(const int64_t start, const int64_t offset) {
+        if (!pieces.empty() and pieces.back().start == start) {
+            pieces.pop_back();
+        }
+        if (!pieces.empty() and pieces.back().offset == offset) {
+            return;
+        }
+        pieces.emplace_back(start, offset);
+    }
+
+    auto pieceAt(const int64_t location) const {
+        return std::prev(std::ranges::upper_bound(pieces, location, {}, &Piece::start));
+    }
+
+    // returns the function next(this(x))
+    PiecewiseMap then(const PiecewiseMap &next) const {
+        PiecewiseMap composed{};
+        composed.pieces.clear();
+        for (auto piece = pieces.begin(); piece != pieces.end(); ++piece) {
+            const auto [start, offset] = *piece;
+            const auto last = std::next(piece) == pieces.end();
+            auto nextPiece = next.pieceAt(start + offset);
+            composed.push(start, offset + nextPiece->offset);
+            // breakpoints of next inside our image split this piece
+            for (++nextPiece; nextPiece != next.pieces.end() and
+                              (last or nextPiece->start - offset < std::next(piece)->start);
+                 ++nextPiece) {
+                composed.push(nextPiece->start - offset, offset + nextPiece->offset);
+            }
+        }
+        return composed;
+    }
+
+    int64_t map(const int64_t from) const { return from + pieceAt(from)->offset; }
+
+    // lowest image of the range, only the pieces it covers are visited
+    int64_t minLocation(const LocationRange &from) const {
+        const auto end = from.first + from.second;
+        auto piece = pieceAt(from.first);
+        auto location = from.first + piece->offset;
+        for (++piece; piece != pieces.end() and piece->start < end; ++piece) {
+            location = std::min(location, piece->start + piece->offset);
+        }
+        return location;
+    }
+};
+
 int64_t minSeed(const std::vector<LocationRange> &locations) { return locations.front().first; }
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [composed|parallel]\n";
         std::exit(EXIT_FAILURE);
     }
+    const std::string mode = argc == 3 ? argv[2] : "";
 
     std::vector<Mapper> mappings{};
     SimpleParser scanner{argv[1]};
@@ -130,6 +254,26 @@ int main(int argc, char **argv) {
     }
 
     int64_t min_location = std::numeric_limits<int64_t>::max();
+    if (mode == "composed") {
+        PiecewiseMap almanac{};
+        for (const auto &mapper : mappings) {
+            almanac = almanac.then(PiecewiseMap{mapper});
+        }
+        fmt::print("Composed almanac has {} pieces\n", almanac.pieces.size());
+
+        for (const auto seed : seeds) {
+            min_location = std::min(min_location, almanac.map(seed));
+        }
+        fmt::print("Lowest location for {} seeds is {}\n", seeds.size(), min_location);
+
+        min_location = std::numeric_limits<int64_t>::max();
+        for (const auto &seedRange : seedPairs) {
+            min_location = std::min(min_location, almanac.minLocation(seedRange));
+        }
+        fmt::print("Lowest location for all seeds is {}\n", min_location);
+        return 0;
+    }
+
     for (auto location : seeds) {
         for (const auto &mapper : mappings) {
             location = mapper.map(location);
@@ -139,7 +283,11 @@ int main(int argc, char **argv) {
     fmt::print("Lowest location for {} seeds is {}\n", seeds.size(), min_location);
 
     for (const auto &mapper : mappings) {
-        seedPairs = mapper.map(seedPairs);
+        if (mode == "parallel") {
+            seedPairs = mapper.mapParallel(seedPairs);
+        } else {
+            seedPairs = mapper.map(seedPairs);
+        }
     }
     min_location = minSeed(seedPairs);
     fmt::print("Lowest location for all seeds is {}\n", min_location);
@@ -1,89 +1,409 @@
 #include <algorithm>
+#include <bit>
+#include <cmath>
+#include <compare>
+#include <execution>
 #include <fmt/format.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
 #include <ranges>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "simpleparser.hpp"
+#include "timeit.hpp"
 
 using std::views::iota;
+__extension__ using int128 = __int128;
+__extension__ using uint128 = unsigned __int128;
 
-struct RaceType {
-    int64_t time;
-    int64_t record;
+template <typename Int> struct Race {
+    Int time;
+    Int record;
 };
+using RaceType = Race<int64_t>;
+using Race128 = Race<int128>;
 
-int64_t raceLength(const int64_t time, const int64_t hold) {
-    const int64_t run = time - hold;
-    return hold * run;
-    // return -1 * hold * hold + time * hold;
+// floor(sqrt(n)), exact for all 128 bit values
+uint128 isqrt(const uint128 n) {
+    constexpr uint128 maxRoot = (uint128{1} << 64) - 1;
+    // long double has a 64 bit mantissa, so the guess is off by at most one
+    auto root = static_cast<uint128>(std::sqrt(static_cast<long double>(n)));
+    while (root > maxRoot or root * root > n) {
+        --root;
+    }
+    while (root < maxRoot and (root + 1) * (root + 1) <= n) {
+        ++root;
+    }
+    return root;
+}
+
+// Holding for h wins if h * (time - h) > record, that is if
+// (2h - time)^2 < time^2 - 4 record. Every u = |2h - time| below the root of
+// that discriminant with the parity of time is a winning hold, counted once
+// for each sign, which gives the number of wins without any search.
+template <typename Int> Int winningGames(const Race<Int> &race) {
+    if (race.time < 0) {
+        return 0;
+    }
+    if (race.record < 0) {
+        return race.time + 1;
+    }
+    const auto time = static_cast<uint128>(race.time);
+    const auto record = static_cast<uint128>(race.record);
+    if (time >> 64 != 0) {
+        throw std::overflow_error("race time exceeds 64 bits");
+    }
+    const auto square = time * time;
+    if (record >= square / 4 + 1) {
+        // the record can't be beaten
+        return 0;
+    }
+    const auto discriminant = square - 4 * record;
+    if (discriminant == 0) {
+        return 0;
+    }
+    const auto root = isqrt(discriminant);
+    auto maxDistance = root * root == discriminant ? root - 1 : root;
+    if ((maxDistance ^ time) & 1) {
+        if (maxDistance == 0) {
+            return 0;
+        }
+        --maxDistance;
+    }
+    return static_cast<Int>(maxDistance + 1);
 }
 
-int64_t raceDeriv(const int64_t time, const int64_t hold) { return -2 * hold + time; }
-
-int64_t findFirstWin(const RaceType &race) {
-    int64_t hold_n = 0;
-    int64_t length_n = raceLength(race.time, hold_n);
-    // fmt::print("x_0: f({}) = {}\n", hold_n, length_n);
-    while (true) {
-        const int64_t hold_n1 = hold_n - (length_n - race.record) / raceDeriv(race.time, hold_n);
-        if (hold_n == hold_n1) {
-            while (length_n <= race.record) {
-                ++hold_n;
-                length_n = raceLength(race.time, hold_n);
-                // fmt::print("inc: f({}) = {}\n", hold_n, length_n);
+// Unsigned big integer, just enough to solve races beyond 128 bits
+struct BigUInt {
+    // little endian, without leading zero limbs
+    std::vector<uint32_t> limbs{};
+
+    BigUInt() = default;
+    explicit BigUInt(uint64_t value) {
+        while (value != 0) {
+            limbs.push_back(static_cast<uint32_t>(value));
+            value >>= 32;
+        }
+    }
+
+    static BigUInt fromString(const std::string &digits) {
+        BigUInt value{};
+        for (const auto digit : digits) {
+            uint64_t carry = static_cast<uint64_t>(digit - '0');
+            for (auto &limb : value.limbs) {
+                carry += uint64_t{limb} * 10;
+                limb = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+            if (carry != 0) {
+                value.limbs.push_back(static_cast<uint32_t>(carry));
             }
-            return hold_n;
         }
-        hold_n = hold_n1;
-        length_n = raceLength(race.time, hold_n);
-        // fmt::print("x_n: f({}) = {}\n", hold_n, length_n);
+        return value;
     }
-    // this is currently not reached, races that can't be won don't finish
-    fmt::print("Error: no win in {}ms\n", race.time);
-    return race.time;
+
+    std::string toString() const {
+        if (isZero()) {
+            return "0";
+        }
+        // peel off 9 decimal digits at a time
+        auto rest = limbs;
+        std::string digits{};
+        while (!rest.empty()) {
+            uint64_t remainder = 0;
+            for (auto &limb : rest | std::views::reverse) {
+                const auto current = (remainder << 32) | limb;
+                limb = static_cast<uint32_t>(current / 1'000'000'000);
+                remainder = current % 1'000'000'000;
+            }
+            while (!rest.empty() and rest.back() == 0) {
+                rest.pop_back();
+            }
+            // the most significant chunk comes without padding zeros
+            for (int digit = 0; digit < 9 and !(rest.empty() and remainder == 0); ++digit) {
+                digits.push_back(static_cast<char>('0' + remainder % 10));
+                remainder /= 10;
+            }
+        }
+        std::ranges::reverse(digits);
+        return digits;
+    }
+
+    void trim() {
+        while (!limbs.empty() and limbs.back() == 0) {
+            limbs.pop_back();
+        }
+    }
+
+    bool isZero() const { return limbs.empty(); }
+    bool isOdd() const { return !limbs.empty() and (limbs.front() & 1) != 0; }
+
+    size_t bitWidth() const {
+        if (limbs.empty()) {
+            return 0;
+        }
+        return 32 * limbs.size() - static_cast<size_t>(std::countl_zero(limbs.back()));
+    }
+
+    std::strong_ordering operator<=>(const BigUInt &other) const {
+        if (limbs.size() != other.limbs.size()) {
+            return limbs.size() <=> other.limbs.size();
+        }
+        for (const auto i : iota(0uz, limbs.size()) | std::views::reverse) {
+            if (limbs[i] != other.limbs[i]) {
+                return limbs[i] <=> other.limbs[i];
+            }
+        }
+        return std::strong_ordering::equal;
+    }
+    bool operator==(const BigUInt &other) const = default;
+
+    BigUInt operator+(const BigUInt &other) const {
+        BigUInt sum{};
+        uint64_t carry = 0;
+        for (const auto i : iota(0uz, std::max(limbs.size(), other.limbs.size()))) {
+            carry += uint64_t{limb(i)} + other.limb(i);
+            sum.limbs.push_back(static_cast<uint32_t>(carry));
+            carry >>= 32;
+        }
+        if (carry != 0) {
+            sum.limbs.push_back(static_cast<uint32_t>(carry));
+        }
+        return sum;
+    }
+
+    // only defined for *this >= other
+    BigUInt operator-(const BigUInt &other) const {
+        BigUInt diff{};
+        int64_t borrow = 0;
+        for (const auto i : iota(0uz, limbs.size())) {
+            auto current = int64_t{limb(i)} - other.limb(i) - borrow;
+            borrow = current < 0 ? 1 : 0;
+            current += borrow << 32;
+            diff.limbs.push_back(static_cast<uint32_t>(current));
+        }
+        diff.trim();
+        return diff;
+    }
+
+    BigUInt operator*(const BigUInt &other) const {
+        BigUInt product{};
+        product.limbs.resize(limbs.size() + other.limbs.size());
+        for (const auto i : iota(0uz, limbs.size())) {
+            uint64_t carry = 0;
+            for (const auto j : iota(0uz, other.limbs.size())) {
+                carry += uint64_t{limbs[i]} * other.limbs[j] + product.limbs[i + j];
+                product.limbs[i + j] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+            product.limbs[i + other.limbs.size()] = static_cast<uint32_t>(carry);
+        }
+        product.trim();
+        return product;
+    }
+
+    BigUInt operator<<(const size_t bits) const {
+        BigUInt shifted{};
+        shifted.limbs.assign(bits / 32, 0);
+        uint32_t carry = 0;
+        for (const auto value : limbs) {
+            shifted.limbs.push_back(bits % 32 == 0 ? value : value << (bits % 32) | carry);
+            carry = bits % 32 == 0 ? 0 : value >> (32 - bits % 32);
+        }
+        shifted.limbs.push_back(carry);
+        shifted.trim();
+        return shifted;
+    }
+
+    BigUInt operator>>(const size_t bits) const {
+        BigUInt shifted{};
+        for (const auto i : iota(bits / 32, limbs.size())) {
+            auto value = limbs[i] >> (bits % 32);
+            if (bits % 32 != 0) {
+                value |= limb(i + 1) << (32 - bits % 32);
+            }
+            shifted.limbs.push_back(value);
+        }
+        shifted.trim();
+        return shifted;
+    }
+
+  private:
+    uint32_t limb(const size_t i) const { return i < limbs.size() ? limbs[i] : 0; }
+};
+
+// floor(sqrt(n)) digit by digit, needs only shifts, additions and compares
+BigUInt isqrt(BigUInt n) {
+    BigUInt root{};
+    if (n.isZero()) {
+        return root;
+    }
+    auto bit = BigUInt{1} << ((n.bitWidth() - 1) & ~size_t{1});
+    while (!bit.isZero()) {
+        const auto trial = root + bit;
+        if (n >= trial) {
+            n = n - trial;
+            root = (root >> 1) + bit;
+        } else {
+            root = root >> 1;
+        }
+        bit = bit >> 2;
+    }
+    return root;
+}
+
+// same closed form as above, for races of any length
+BigUInt winningGames(const Race<BigUInt> &race) {
+    const auto square = race.time * race.time;
+    const auto fourRecord = race.record << 2;
+    if (fourRecord >= square) {
+        return {};
+    }
+    const auto discriminant = square - fourRecord;
+    const auto root = isqrt(discriminant);
+    auto maxDistance = root * root == discriminant ? root - BigUInt{1} : root;
+    if (maxDistance.isOdd() != race.time.isOdd()) {
+        if (maxDistance.isZero()) {
+            return {};
+        }
+        maxDistance = maxDistance - BigUInt{1};
+    }
+    return maxDistance + BigUInt{1};
 }
 
-int64_t findWinningGames(const RaceType &race) {
-    const auto first = findFirstWin(race);
-    const auto last = race.time - first;
-    return last - first + 1;
+std::optional<int128> parseInt128(const std::string &digits) {
+    constexpr auto maxValue = std::numeric_limits<int128>::max();
+    int128 value = 0;
+    for (const auto c : digits) {
+        const auto digit = c - '0';
+        if (value > (maxValue - digit) / 10) {
+            return {};
+        }
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+// The kerned race glues all digits together and quickly outgrows 64 bits.
+// Solve it with every integer width the numbers fit in and time each of them,
+// big integers are only used when nothing else fits.
+std::string kernedRace(const std::string &time, const std::string &record) {
+    std::string answer{};
+    const auto timed = [&answer](const std::string &width, const auto &solve) {
+        const auto t1 = timeNow();
+        answer = fmt::format("{}", solve());
+        const auto t2 = timeNow();
+        fmt::print("Kerned race with {:>6} took {:.9f}s\n", width, timeDiff(t1, t2));
+    };
+
+    const auto time128 = parseInt128(time);
+    const auto record128 = parseInt128(record);
+    if (time128 and record128) {
+        constexpr int128 max64 = std::numeric_limits<int64_t>::max();
+        if (*time128 <= max64 and *record128 <= max64) {
+            const RaceType race{static_cast<int64_t>(*time128), static_cast<int64_t>(*record128)};
+            timed("int64", [&race] { return winningGames(race); });
+        }
+        if (*time128 >> 64 == 0) {
+            const Race128 race{*time128, *record128};
+            timed("int128", [&race] { return winningGames(race); });
+        }
+    }
+    if (answer.empty()) {
+        const Race<BigUInt> race{BigUInt::fromString(time), BigUInt::fromString(record)};
+        timed("bignum", [&race] { return winningGames(race).toString(); });
+    }
+    return answer;
+}
+
+// Evaluate many races at once, spread over all cores and vector lanes. Race
+// times must fit 64 bits, as nothing may throw inside the parallel transform.
+template <typename Int> std::vector<Int> winningGames(std::span<const Race<Int>> races) {
+    std::vector<Int> games(races.size());
+    std::transform(std::execution::par_unseq, races.begin(), races.end(), games.begin(),
+                   [](const Race<Int> &race) { return winningGames(race); });
+    return games;
+}
+
+void benchmark() {
+    constexpr size_t raceCount = 10'000'000;
+    std::mt19937_64 rng{2023};
+    std::uniform_int_distribution<int64_t> timeDist{1, 3'000'000'000};
+    std::vector<RaceType> races{};
+    races.reserve(raceCount);
+    for ([[maybe_unused]] const auto _ : iota(0u, raceCount)) {
+        const auto time = timeDist(rng);
+        const auto best = time / 2 * (time - time / 2);
+        const auto record = std::uniform_int_distribution<int64_t>{0, best}(rng);
+        races.emplace_back(time, record);
+    }
+
+    const auto t1 = timeNow();
+    const auto games = winningGames<int64_t>(races);
+    const auto t2 = timeNow();
+    int64_t total = 0;
+    for (const auto g : games) {
+        total += g;
+    }
+    fmt::print("{} races with {} winning games in {:.3f}s\n", raceCount, total, timeDiff(t1, t2));
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [bench]\n";
         std::exit(EXIT_FAILURE);
     }
+    const std::string mode = argc == 3 ? argv[2] : "";
 
     SimpleParser scanner{argv[1]};
-    std::vector<RaceType> competition{};
+    std::vector<Race128> competition{};
+    const auto parse = [](const std::string &digits) {
+        const auto value = parseInt128(digits);
+        if (!value) {
+            fmt::print("{} does not fit 128 bits\n", digits);
+            std::exit(EXIT_FAILURE);
+        }
+        return *value;
+    };
 
     scanner.skipToken("Time:");
     std::string time2{};
     while (!scanner.isEof() and std::isdigit(scanner.peekChar())) {
-        const auto time = scanner.getInt64();
-        competition.emplace_back(time);
-        time2 += fmt::format("{}", time);
+        const auto time = scanner.getAlNum();
+        competition.emplace_back(parse(time));
+        time2 += time;
     }
     scanner.skipToken("Distance:");
     std::string record2{};
-    int id = 0;
+    size_t id = 0;
     while (!scanner.isEof() and std::isdigit(scanner.peekChar())) {
-        const auto record = scanner.getInt64();
-        competition[id].record = record;
-        record2 += fmt::format("{}", record);
+        const auto record = scanner.getAlNum();
+        competition[id].record = parse(record);
+        record2 += record;
         ++id;
     }
-    RaceType competition2{std::stoll(time2), std::stoll(record2)};
+    const auto overlong = [](const Race128 &race) { return race.time >> 64 != 0; };
+    if (std::ranges::any_of(competition, overlong)) {
+        fmt::print("Race times must fit 64 bits\n");
+        std::exit(EXIT_FAILURE);
+    }
 
-    int64_t prod1 = 1;
-    for (const auto &race : competition) {
-        prod1 *= findWinningGames(race);
+    // each race has less than 2^64 winning games, but their product may need more than 128 bits
+    BigUInt prod1{1};
+    for (const auto games : winningGames<int128>(competition)) {
+        prod1 = prod1 * BigUInt{static_cast<uint64_t>(games)};
     }
-    fmt::print("Answer: {} [Submit]\n", prod1);
+    fmt::print("Answer: {} [Submit]\n", prod1.toString());
 
-    fmt::print("Answer: {} [Submit]\n", findWinningGames(competition2));
+    fmt::print("Answer: {} [Submit]\n", kernedRace(time2, record2));
+
+    if (mode == "bench") {
+        benchmark();
+    }
 }
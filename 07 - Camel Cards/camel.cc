@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <array>
+#include <execution>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "simpleparser.hpp"
+#include "timeit.hpp"
+
+using std::views::iota;
+
+enum HandType { High, OnePair, TwoPair, Three, FullHouse, Four, Five };
+
+// Hand type by wildcards and signature. The signature sums, over all cards
+// that are not wild, how often their rank appears in the hand. That is the sum
+// of squares of the group sizes, which is unique for every grouping of up to
+// five cards. The wildcards always join the largest group.
+constexpr auto typeTable = [] {
+    std::array<std::array<HandType, 26>, 6> table{};
+    const auto typeOf = [](const int largest, const int second) {
+        switch (largest) {
+        case 5:
+            return Five;
+        case 4:
+            return Four;
+        case 3:
+            return second == 2 ? FullHouse : Three;
+        case 2:
+            return second == 2 ? TwoPair : OnePair;
+        }
+        return High;
+    };
+    // all group sizes a >= b >= c >= d >= e of the cards that are not wild
+    for (int a = 0; a <= 5; ++a) {
+        for (int b = 0; b <= a; ++b) {
+            for (int c = 0; c <= b; ++c) {
+                for (int d = 0; d <= c; ++d) {
+                    for (int e = 0; e <= d; ++e) {
+                        const auto cards = a + b + c + d + e;
+                        if (cards <= 5) {
+                            table[5 - cards][a * a + b * b + c * c + d * d + e * e] =
+                                typeOf(a + 5 - cards, b);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return table;
+}();
+
+// rules of the game: cards from weakest to strongest, and the wild card
+struct Standard {
+    static constexpr std::string_view order = "23456789TJQKA";
+    static constexpr char wildcard = '\0';
+};
+
+struct Jokers {
+    static constexpr std::string_view order = "J23456789TQKA";
+    static constexpr char wildcard = 'J';
+};
+
+struct Draw {
+    std::array<char, 5> cards{};
+    int64_t bid{};
+
+    Draw(const std::string &draw, const int64_t bid) : bid(bid) {
+        if (draw.size() != 5 or
+            !std::ranges::all_of(draw, [](const char c) { return Standard::order.contains(c); })) {
+            fmt::print("Invalid hand '{}'\n", draw);
+            throw;
+        }
+        std::ranges::copy(draw, cards.begin());
+    }
+};
+
+template <typename Rules> struct CamelCards {
+    // the wildcard has rank 0, all other cards rank from 1 up in order
+    static constexpr auto rank = [] {
+        std::array<uint8_t, 128> table{};
+        for (const auto i : iota(0u, Rules::order.size())) {
+            const auto card = Rules::order[i];
+            table[static_cast<size_t>(card)] =
+                static_cast<uint8_t>(card == Rules::wildcard ? 0 : i + 1);
+        }
+        return table;
+    }();
+
+    static uint8_t rankOf(const char card) { return rank[static_cast<size_t>(card)]; }
+
+    static HandType type(const Draw &draw) {
+        std::array<int, 16> count{};
+        for (const auto card : draw.cards) {
+            count[rankOf(card)] += 1;
+        }
+        const auto wildcards = Rules::wildcard == '\0' ? 0 : count[0];
+        auto signature = -wildcards * wildcards;
+        for (const auto card : draw.cards) {
+            signature += count[rankOf(card)];
+        }
+        return typeTable[wildcards][signature];
+    }
+
+    // type above the five card ranks as 4 bit digits, so comparing keys is
+    // the same as comparing hands
+    static uint32_t key(const Draw &draw) {
+        auto packed = static_cast<uint32_t>(type(draw));
+        for (const auto card : draw.cards) {
+            packed = packed << 4 | rankOf(card);
+        }
+        return packed;
+    }
+};
+
+struct RankedHand {
+    uint32_t key;
+    int64_t bid;
+};
+
+// LSD radix sort over the 8 bit digits of the 23 bit hand keys
+void radixSort(std::vector<RankedHand> &hands) {
+    std::vector<RankedHand> buffer(hands.size());
+    for (unsigned shift = 0; shift < 24; shift += 8) {
+        std::array<size_t, 257> offset{};
+        for (const auto &hand : hands) {
+            ++offset[((hand.key >> shift) & 0xff) + 1];
+        }
+        std::partial_sum(offset.begin(), offset.end(), offset.begin());
+        for (const auto &hand : hands) {
+            buffer[offset[(hand.key >> shift) & 0xff]++] = hand;
+        }
+        std::swap(hands, buffer);
+    }
+}
+
+int64_t totalWinnings(std::vector<RankedHand> &hands) {
+    radixSort(hands);
+    int64_t total = 0;
+    int64_t rank = 1;
+    for (const auto &hand : hands) {
+        total += hand.bid * rank;
+        ++rank;
+    }
+    return total;
+}
+
+int64_t totalWinningsParallel(std::vector<RankedHand> &hands) {
+    std::sort(std::execution::par_unseq, hands.begin(), hands.end(),
+              [](const auto &a, const auto &b) { return a.key < b.key; });
+    // the rank of a hand is its position in the sorted vector
+    std::vector<int64_t> positions(hands.size());
+    std::iota(positions.begin(), positions.end(), 0);
+    return std::transform_reduce(std::execution::par_unseq, positions.begin(), positions.end(),
+                                 int64_t{0}, std::plus{}, [&hands](const int64_t i) {
+                                     return hands[static_cast<size_t>(i)].bid * (i + 1);
+                                 });
+}
+
+template <typename Rules> std::vector<RankedHand> keyHands(const std::vector<Draw> &draws) {
+    std::vector<RankedHand> hands(draws.size());
+    std::transform(std::execution::par_unseq, draws.begin(), draws.end(), hands.begin(),
+                   [](const Draw &draw) {
+                       return RankedHand{CamelCards<Rules>::key(draw), draw.bid};
+                   });
+    return hands;
+}
+
+// Time the serial and the parallel ranking on random hands. Equal hands get
+// equal bids, so both sorts must agree on the winnings.
+template <typename Rules> void benchmark(const std::vector<Draw> &draws, const std::string &name) {
+    auto hands = keyHands<Rules>(draws);
+    auto parallelHands = hands;
+
+    const auto t1 = timeNow();
+    const auto total = totalWinnings(hands);
+    const auto t2 = timeNow();
+    const auto parallelTotal = totalWinningsParallel(parallelHands);
+    const auto t3 = timeNow();
+
+    fmt::print("{}: radix sort {:.3f}s, parallel sort {:.3f}s\n", name, timeDiff(t1, t2),
+               timeDiff(t2, t3));
+    if (total != parallelTotal) {
+        fmt::print("Mismatch: {} != {}\n", total, parallelTotal);
+    }
+}
+
+void benchmark(const size_t handCount) {
+    std::mt19937_64 rng{2023};
+    std::uniform_int_distribution<size_t> cardDist{0, Standard::order.size() - 1};
+    std::vector<Draw> draws{};
+    draws.reserve(handCount);
+    std::string cards(5, ' ');
+    for ([[maybe_unused]] const auto _ : iota(0uz, handCount)) {
+        int64_t bid = 0;
+        for (auto &card : cards) {
+            card = Standard::order[cardDist(rng)];
+            bid = bid * 31 + card;
+        }
+        draws.emplace_back(cards, bid % 1000 + 1);
+    }
+    fmt::print("Ranking {} random hands\n", handCount);
+    benchmark<Standard>(draws, "standard");
+    benchmark<Jokers>(draws, "jokers");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 or argc > 4) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [parallel|bench [hands]]\n";
+        std::exit(EXIT_FAILURE);
+    }
+    const std::string mode = argc >= 3 ? argv[2] : "";
+
+    std::vector<Draw> listOfHands{};
+
+    SimpleParser scanner{argv[1]};
+    while (!scanner.isEof()) {
+        const auto cards = scanner.getToken();
+        const auto value = scanner.getInt64();
+        listOfHands.emplace_back(cards, value);
+    }
+
+    if (mode == "parallel") {
+        auto standardHands = keyHands<Standard>(listOfHands);
+        auto jokerHands = keyHands<Jokers>(listOfHands);
+        fmt::print("The total winnings are {} cards\n", totalWinningsParallel(standardHands));
+        fmt::print("With jokers the total winnings are {} cards\n",
+                   totalWinningsParallel(jokerHands));
+        return 0;
+    }
+
+    // key both rule sets in one pass over the hands
+    std::vector<RankedHand> standardHands{};
+    std::vector<RankedHand> jokerHands{};
+    standardHands.reserve(listOfHands.size());
+    jokerHands.reserve(listOfHands.size());
+    for (const auto &hand : listOfHands) {
+        standardHands.emplace_back(CamelCards<Standard>::key(hand), hand.bid);
+        jokerHands.emplace_back(CamelCards<Jokers>::key(hand), hand.bid);
+    }
+
+    fmt::print("The total winnings are {} cards\n", totalWinnings(standardHands));
+    fmt::print("With jokers the total winnings are {} cards\n", totalWinnings(jokerHands));
+
+    if (mode == "bench") {
+        benchmark(argc == 4 ? std::stoull(argv[3]) : 10'000'000);
+    }
+}
@@ -1,14 +1,23 @@
 #include <algorithm>
+#include <array>
+#include <execution>
 #include <fmt/format.h>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <optional>
+#include <random>
 #include <ranges>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "simpleparser.hpp"
+#include "timeit.hpp"
 
 using std::views::iota;
 
@@ -19,8 +28,109 @@ struct Node {
     auto operator<=>(const Node &other) const { return name <=> other.name; }
 };
 
+std::map<std::string, Node> network;
+std::string directions{};
+
+// The network with node names interned to dense ids. A step is a single
+// array load instead of a map lookup and a string copy.
+struct CompiledNetwork {
+    std::vector<std::string> names{};
+    // successors of each node, indexed by [node][0 = left, 1 = right]
+    std::vector<std::array<uint32_t, 2>> next{};
+    std::vector<uint8_t> turns{};
+
+    void compile() {
+        std::unordered_map<std::string, uint32_t> ids{};
+        for (const auto &[name, _] : network) {
+            ids.emplace(name, static_cast<uint32_t>(names.size()));
+            names.push_back(name);
+        }
+        const auto idOf = [&ids](const std::string &name) {
+            const auto id = ids.find(name);
+            if (id == ids.end()) {
+                fmt::print("Unknown node {}\n", name);
+                std::exit(EXIT_FAILURE);
+            }
+            return id->second;
+        };
+        for (const auto &[_, node] : network) {
+            next.push_back({idOf(node.left), idOf(node.right)});
+        }
+        for (const auto direction : directions) {
+            switch (direction) {
+            case 'L':
+                turns.push_back(0);
+                break;
+            case 'R':
+                turns.push_back(1);
+                break;
+            default:
+                fmt::print("Unknown direction\n");
+            }
+        }
+    }
+
+    uint32_t step(const uint32_t node, const size_t step) const { return next[node][turns[step]]; }
+
+    std::optional<uint32_t> find(const std::string &name) const {
+        const auto it = std::ranges::lower_bound(names, name);
+        if (it == names.end() or *it != name) {
+            return {};
+        }
+        return static_cast<uint32_t>(it - names.begin());
+    }
+};
+
+CompiledNetwork compiled{};
+
+// Where each node ends up after following all directions once, and after
+// which steps of that pass a target node was reached. Walking the network a
+// whole direction cycle per lookup makes loops cost O(nodes) instead of steps.
+struct CycleTable {
+    std::vector<uint32_t> end{};
+    // hit offsets in 1..directions.size() of node n are hitOffsets[hitIndex[n]..hitIndex[n+1])
+    std::vector<uint32_t> hitOffsets{};
+    std::vector<size_t> hitIndex{0};
+    size_t cycleSteps{};
+
+    // Every node is walked on its own, so the table is built in parallel: one
+    // pass for the ends and the hit counts, another to fill in the hits.
+    CycleTable(const CompiledNetwork &network, const std::vector<uint8_t> &isTarget)
+        : end(network.names.size()), hitIndex(network.names.size() + 1, 0),
+          cycleSteps(network.turns.size()) {
+        const auto walkCycle = [&](const uint32_t node, const auto &onHit) {
+            auto current = node;
+            for (const auto step : iota(0u, cycleSteps)) {
+                current = network.step(current, step);
+                if (isTarget[current]) {
+                    onHit(static_cast<uint32_t>(step + 1));
+                }
+            }
+            return current;
+        };
+        std::vector<uint32_t> nodes(network.names.size());
+        std::iota(nodes.begin(), nodes.end(), 0);
+
+        std::for_each(std::execution::par, nodes.begin(), nodes.end(), [&](const uint32_t node) {
+            size_t count = 0;
+            end[node] = walkCycle(node, [&count](uint32_t) { ++count; });
+            hitIndex[node + 1] = count;
+        });
+        std::inclusive_scan(hitIndex.begin(), hitIndex.end(), hitIndex.begin());
+        hitOffsets.resize(hitIndex.back());
+        std::for_each(std::execution::par, nodes.begin(), nodes.end(), [&](const uint32_t node) {
+            auto out = hitIndex[node];
+            walkCycle(node, [&](const uint32_t offset) { hitOffsets[out++] = offset; });
+        });
+    }
+
+    std::span<const uint32_t> hits(const uint32_t node) const {
+        return std::span{hitOffsets}.subspan(hitIndex[node], hitIndex[node + 1] - hitIndex[node]);
+    }
+};
+
 struct Position {
-    std::string node;
+    uint32_t node;
     size_t step;
     auto operator<=>(const Position &other) const {
         return std::pair(node, step) <=> std::pair(other.node, other.step);
@@ -36,35 +146,20 @@ template <> struct fmt::formatter<Position> {
     template <typename FormatContext>
     constexpr auto format(const Position &position, FormatContext &ctx) const
         -> decltype(ctx.out()) {
-        return fmt::format_to(ctx.out(), "{}@{}", position.node, position.step);
+        return fmt::format_to(ctx.out(), "{}@{}", compiled.names[position.node], position.step);
     }
 };
 
-std::map<std::string, Node> network;
-std::string directions{};
-
-std::string networkStep(const std::string &position, size_t step) {
-    switch (directions[step]) {
-    case 'L':
-        return network[position].left;
-        break;
-    case 'R':
-        return network[position].right;
-        break;
-    default:
-        fmt::print("Unknown direction\n");
-        return position;
-    }
-}
-
 void navi1();
 void navi2();
+void benchmark();
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [bench]\n";
         std::exit(EXIT_FAILURE);
     }
+    const std::string mode = argc == 3 ? argv[2] : "";
 
     SimpleParser scanner{argv[1]};
     directions = scanner.getLine();
@@ -77,87 +172,342 @@ int main(int argc, char **argv) {
         scanner.skipChar(')');
         network.emplace(name, Node{name, left, right});
     }
+    compiled.compile();
     navi1();
     fmt::print("\n");
     navi2();
+
+    if (mode == "bench") {
+        fmt::print("\n");
+        benchmark();
+    }
 }
 
 void navi1() {
-    size_t totalSteps = 0;
-    std::string position = "AAA";
-    size_t step = 0;
-
-    fmt::print("step {} position {}\n", step, position);
+    const auto start = compiled.find("AAA");
+    const auto target = compiled.find("ZZZ");
 
-    if (!network.contains(position)) {
+    if (!start or !target) {
         fmt::print("Bad input for part 1\n");
         return;
     }
+    fmt::print("step {} position {}\n", 0, compiled.names[*start]);
+
+    std::vector<uint8_t> isTarget(compiled.names.size(), 0);
+    isTarget[*target] = 1;
+    const CycleTable table{compiled, isTarget};
 
-    while (position != "ZZZ") {
-        position = networkStep(position, step);
-        ++step;
-        if (step == directions.size()) {
-            step = 0;
+    // skip whole direction cycles until one passes ZZZ
+    size_t totalSteps = 0;
+    if (*start != *target) {
+        std::vector<uint8_t> seen(compiled.names.size(), 0);
+        auto position = *start;
+        size_t cycles = 0;
+        while (table.hits(position).empty()) {
+            if (seen[position]) {
+                fmt::print("You walk in circles and never reach ZZZ\n");
+                return;
+            }
+            seen[position] = 1;
+            position = table.end[position];
+            ++cycles;
         }
-        ++totalSteps;
-        fmt::print("step {} position {}\n", step, position);
+        totalSteps = cycles * table.cycleSteps + table.hits(position).front();
     }
     fmt::print("You took {} steps\n", totalSteps);
 }
 
-void navi2() {
-    size_t ghostSteps = 1;
-    bool lcmIsSafe = true;
+__extension__ using int128 = __int128;
 
-    for (auto &[name, _] : network) {
-        if (name[2] != 'A') {
-            continue;
+// All times a ghost stands on a terminal. Up to loopStart they are listed in
+// prefixHits, afterwards they repeat every loopSteps starting from loopHits,
+// which holds the terminal times in (loopStart, loopStart + loopSteps].
+struct GhostCycle {
+    uint32_t start{};
+    size_t loopStart{};
+    size_t loopSteps{};
+    std::vector<size_t> prefixHits{};
+    std::vector<size_t> loopHits{};
+
+    bool hits(const int128 steps) const {
+        if (steps <= static_cast<int128>(loopStart)) {
+            return std::ranges::binary_search(prefixHits, static_cast<size_t>(steps));
         }
-        auto position = Position{name, 0};
-        fmt::print("starting at {}\n", position);
+        const auto inLoop = static_cast<size_t>((steps - loopStart - 1) % loopSteps);
+        return std::ranges::binary_search(loopHits, loopStart + inLoop + 1);
+    }
+};
 
-        const auto startingPosition = position;
-        size_t step = 0;
+// Brent's cycle detection on the direction cycle starts. The state at a cycle
+// start is just the node, as the step index is always 0 there.
+GhostCycle analyseGhost(const CycleTable &table, const uint32_t start) {
+    const auto cycleSteps = table.cycleSteps;
+    size_t power = 1;
+    size_t cycles = 1;
+    auto tortoise = start;
+    auto hare = table.end[start];
+    while (tortoise != hare) {
+        if (power == cycles) {
+            tortoise = hare;
+            power *= 2;
+            cycles = 0;
+        }
+        hare = table.end[hare];
+        ++cycles;
+    }
+    tortoise = hare = start;
+    for ([[maybe_unused]] const auto _ : iota(0uz, cycles)) {
+        hare = table.end[hare];
+    }
+    size_t prefixCycles = 0;
+    while (tortoise != hare) {
+        tortoise = table.end[tortoise];
+        hare = table.end[hare];
+        ++prefixCycles;
+    }
 
-        size_t prefixSteps = 0;
-        do {
-            position = Position{networkStep(position.node, step), step};
-            ++step;
-            if (step == directions.size()) {
-                step = 0;
+    GhostCycle ghost{start, prefixCycles * cycleSteps, cycles * cycleSteps, {}, {}};
+    auto current = start;
+    for (const auto cycle : iota(0uz, prefixCycles + cycles)) {
+        for (const auto offset : table.hits(current)) {
+            const auto steps = cycle * cycleSteps + offset;
+            if (steps <= ghost.loopStart) {
+                ghost.prefixHits.push_back(steps);
+            } else {
+                ghost.loopHits.push_back(steps);
             }
-            ++prefixSteps;
-        } while (position.node[2] != 'Z');
-        const auto firstTerminalPosition = position;
-
-        size_t loopSteps = 0;
-        do {
-            position = Position{networkStep(position.node, step), step};
-            ++step;
-            if (step == directions.size()) {
-                step = 0;
+        }
+        current = table.end[current];
+    }
+    return ghost;
+}
+
+// every ghost is an independent task on the shared, read only table
+std::vector<GhostCycle> analyseGhosts(const auto &policy, const CycleTable &table,
+                                      const std::vector<uint32_t> &starts) {
+    std::vector<GhostCycle> ghosts(starts.size());
+    std::transform(policy, starts.begin(), starts.end(), ghosts.begin(),
+                   [&table](const uint32_t start) { return analyseGhost(table, start); });
+    return ghosts;
+}
+
+int128 gcdExtended(const int128 a, const int128 b, int128 &x, int128 &y) {
+    if (b == 0) {
+        x = 1;
+        y = 0;
+        return a;
+    }
+    int128 x1{};
+    int128 y1{};
+    const auto g = gcdExtended(b, a % b, x1, y1);
+    x = y1;
+    y = x1 - a / b * y1;
+    return g;
+}
+
+__extension__ using uint128 = unsigned __int128;
+
+// a * b mod m for 0 <= a, b < m, doubling in unsigned 128 bits if the product overflows
+int128 mulMod(const int128 a, const int128 b, const int128 m) {
+    int128 product{};
+    if (!__builtin_mul_overflow(a, b, &product)) {
+        return product % m;
+    }
+    const auto modulus = static_cast<uint128>(m);
+    uint128 result = 0;
+    auto base = static_cast<uint128>(a);
+    for (auto factor = static_cast<uint128>(b); factor != 0; factor >>= 1) {
+        if (factor & 1) {
+            result = (result + base) % modulus;
+        }
+        base = (base + base) % modulus;
+    }
+    return static_cast<int128>(result);
+}
+
+// generalized CRT: solve x = a mod m and x = b mod n, moduli need not be coprime
+// and 0 <= a < m, 0 <= b < n. Throws if the combined modulus needs more than 128 bits.
+std::optional<std::pair<int128, int128>> crt(const int128 a, const int128 m, const int128 b,
+                                             const int128 n) {
+    int128 p{};
+    int128 q{};
+    const auto g = gcdExtended(m, n, p, q);
+    if ((b - a) % g != 0) {
+        return {};
+    }
+    int128 lcm{};
+    if (__builtin_mul_overflow(m / g, n, &lcm)) {
+        throw std::overflow_error("the combined ghost loop length exceeds 128 bits");
+    }
+    const auto step = n / g;
+    const auto diff = ((b - a) / g % step + step) % step;
+    const auto k = mulMod(diff, (p % step + step) % step, step);
+    int128 x{};
+    if (__builtin_mul_overflow(m, k, &x) or __builtin_add_overflow(x, a, &x)) {
+        throw std::overflow_error("the meeting step exceeds 128 bits");
+    }
+    return std::pair{x % lcm, lcm};
+}
+
+// The first step where all ghosts stand on a terminal at once. Throws if the
+// answer does not fit 128 bits or the terminal combinations get out of hand.
+std::optional<int128> meetingSteps(const std::vector<GhostCycle> &ghosts) {
+    const auto hitByAll = [&ghosts](const int128 steps) {
+        return std::ranges::all_of(ghosts,
+                                   [steps](const auto &ghost) { return ghost.hits(steps); });
+    };
+
+    // before every ghost is inside its loop, check the terminals of the first one
+    const auto &first = ghosts.front();
+    const auto allLooping =
+        static_cast<int128>(std::ranges::max(ghosts, {}, &GhostCycle::loopStart).loopStart);
+    for (const auto steps : first.prefixHits) {
+        if (hitByAll(steps)) {
+            return steps;
+        }
+    }
+    for (int128 loop = 0; first.loopStart + loop * first.loopSteps < allLooping; ++loop) {
+        for (const auto steps : first.loopHits) {
+            const auto current = steps + loop * first.loopSteps;
+            if (current <= allLooping and hitByAll(current)) {
+                return current;
             }
-            ++loopSteps;
-            if (position.node[2] == 'Z' and position != firstTerminalPosition) {
-                fmt::print("CAUTION: Possible additional terminal at {}+{}\n", prefixSteps,
-                           loopSteps);
-                lcmIsSafe = false;
+        }
+    }
+
+    // afterwards every ghost is periodic, combine all terminal residues
+    constexpr size_t maxResidues = 1'000'000;
+    std::vector<std::pair<int128, int128>> residues{{0, 1}};
+    for (const auto &ghost : ghosts) {
+        std::vector<std::pair<int128, int128>> combined{};
+        for (const auto &[residue, modulus] : residues) {
+            for (const auto steps : ghost.loopHits) {
+                const int128 loopSteps = ghost.loopSteps;
+                const auto solution = crt(residue, modulus, steps % loopSteps, loopSteps);
+                if (solution) {
+                    combined.push_back(*solution);
+                }
+                if (combined.size() > maxResidues) {
+                    throw std::length_error("more than a million terminal step combinations");
+                }
             }
-        } while (position != firstTerminalPosition);
+        }
+        std::ranges::sort(combined);
+        const auto duplicates = std::ranges::unique(combined);
+        combined.erase(duplicates.begin(), duplicates.end());
+        residues = std::move(combined);
+    }
 
-        fmt::print("Ghost route from {} to {} took {} + {} * n steps\n", startingPosition, position,
-                   prefixSteps, loopSteps);
+    std::optional<int128> best{};
+    for (const auto &[residue, modulus] : residues) {
+        // smallest steps > allLooping with steps = residue mod modulus
+        auto offset = (residue - allLooping - 1) % modulus;
+        if (offset < 0) {
+            offset += modulus;
+        }
+        int128 steps{};
+        if (__builtin_add_overflow(allLooping + 1, offset, &steps)) {
+            throw std::overflow_error("the meeting step exceeds 128 bits");
+        }
+        if (!best or steps < *best) {
+            best = steps;
+        }
+    }
+    return best;
+}
 
-        if (prefixSteps != loopSteps) {
-            fmt::print("CAUTION: prefix steps {} != loop steps {}\n", prefixSteps, loopSteps);
-            lcmIsSafe = false;
+void navi2() {
+    std::vector<uint8_t> isTarget{};
+    std::vector<uint32_t> starts{};
+    for (const auto node : iota(0u, compiled.names.size())) {
+        isTarget.push_back(compiled.names[node][2] == 'Z');
+        if (compiled.names[node][2] == 'A') {
+            starts.push_back(node);
         }
+    }
+    if (starts.empty()) {
+        fmt::print("No ghosts found\n");
+        return;
+    }
+    const CycleTable table{compiled, isTarget};
+
+    const auto ghosts = analyseGhosts(std::execution::par, table, starts);
 
-        ghostSteps = std::lcm(ghostSteps, prefixSteps);
+    for (const auto &ghost : ghosts) {
+        fmt::print("Ghost route from {} loops every {} steps after {} steps, with {} + {} "
+                   "terminals\n",
+                   Position{ghost.start, 0}, ghost.loopSteps, ghost.loopStart,
+                   ghost.prefixHits.size(), ghost.loopHits.size());
     }
-    fmt::print("Your ghost took {} steps\n", ghostSteps);
-    if (!lcmIsSafe) {
-        printf("CAUTION: Solution might be wrong!\n");
+
+    try {
+        const auto steps = meetingSteps(ghosts);
+        if (steps) {
+            fmt::print("Your ghost took {} steps\n", *steps);
+        } else {
+            fmt::print("Your ghosts never stand on terminals at the same time\n");
+        }
+    } catch (const std::exception &e) {
+        fmt::print("Cannot solve for your ghosts: {}\n", e.what());
+    }
+}
+
+// Time the ghost analysis on a random network with many ghosts, once in
+// sequence and once with a task per ghost.
+void benchmark() {
+    constexpr size_t nodeCount = 40'000;
+    constexpr size_t ghostCount = 500;
+    constexpr size_t directionCount = 293;
+    constexpr std::string_view alphabet = "0123456789BCDEFGHIJKLMNOPQRSTUVWXY";
+
+    std::mt19937 rng{2023};
+    CompiledNetwork random{};
+    for (const auto a : alphabet) {
+        for (const auto b : alphabet) {
+            for (const auto c : {'A', 'Z'}) {
+                random.names.push_back(std::string{a, b, c});
+            }
+        }
+    }
+    for (const auto a : alphabet) {
+        for (const auto b : alphabet) {
+            for (const auto c : alphabet) {
+                if (random.names.size() < nodeCount) {
+                    random.names.push_back(std::string{a, b, c});
+                }
+            }
+        }
+    }
+    std::uniform_int_distribution<uint32_t> nodeDist{0, nodeCount - 1};
+    for ([[maybe_unused]] const auto _ : iota(0uz, nodeCount)) {
+        random.next.push_back({nodeDist(rng), nodeDist(rng)});
+    }
+    for ([[maybe_unused]] const auto _ : iota(0uz, directionCount)) {
+        random.turns.push_back(static_cast<uint8_t>(rng() & 1));
+    }
+
+    std::vector<uint8_t> isTarget{};
+    std::vector<uint32_t> starts{};
+    for (const auto node : iota(0u, nodeCount)) {
+        isTarget.push_back(random.names[node][2] == 'Z');
+        if (random.names[node][2] == 'A' and starts.size() < ghostCount) {
+            starts.push_back(node);
+        }
+    }
+
+    const auto t1 = timeNow();
+    const CycleTable table{random, isTarget};
+    const auto t2 = timeNow();
+    const auto serial = analyseGhosts(std::execution::seq, table, starts);
+    const auto t3 = timeNow();
+    const auto parallel = analyseGhosts(std::execution::par, table, starts);
+    const auto t4 = timeNow();
+
+    fmt::print("{} ghosts in {} nodes: table {:.3f}s, serial {:.3f}s, parallel {:.3f}s\n",
+               starts.size(), nodeCount, timeDiff(t1, t2), timeDiff(t2, t3), timeDiff(t3, t4));
+    const auto sameLoops = std::ranges::equal(serial, parallel, {}, &GhostCycle::loopSteps,
+                                              &GhostCycle::loopSteps);
+    if (!sameLoops) {
+        fmt::print("Serial and parallel analysis disagree\n");
     }
 }
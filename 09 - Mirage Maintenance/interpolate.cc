@@ -1,9 +1,17 @@
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <execution>
 #include <fmt/format.h>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <numeric>
+#include <optional>
 #include <ranges>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "simpleparser.hpp"
@@ -22,6 +30,25 @@ Seq readDataLine(SimpleParser &scan) {
     return data;
 }
 
+// faster than SimpleParser for the big generated inputs
+void parseRow(const std::string &line, Seq &row) {
+    row.clear();
+    const auto *pos = line.data();
+    const auto *const end = line.data() + line.size();
+    while (pos != end) {
+        while (pos != end and *pos == ' ') {
+            ++pos;
+        }
+        int64_t value{};
+        const auto [next, ec] = std::from_chars(pos, end, value);
+        if (ec != std::errc{}) {
+            break;
+        }
+        row.push_back(value);
+        pos = next;
+    }
+}
+
 void print(const Seq &data) {
     if (data.size() == 0) {
         fmt::print("[]\n");
@@ -34,47 +61,250 @@ void print(const Seq &data) {
     fmt::print("]\n");
 }
 
-int64_t nextValue(const Seq &data) {
-    Seq delta{};
-    bool allZero = true;
-    for (const auto &value : data | std::views::adjacent_transform<2>(
-                                        [](const auto n0, const auto n1) { return n1 - n0; })) {
-        if (value != 0) {
-            allZero = false;
+// The differences of a row become constant after at most n-1 levels, so the
+// row is continued by the polynomial of degree n-1 through its n values. By
+// Lagrange interpolation on 0..n-1 the next and the previous value are
+//   next = sum (-1)^(n-1-i) C(n, i) a_i
+//   prev = sum (-1)^i C(n, i+1) a_i
+// so both are a dot product with a fixed weight row per row length.
+// The binomials outgrow 64 bits for rows of about 67 values, so weights and
+// sums are kept modulo 2^64 in unsigned arithmetic. The results fit in
+// int64_t, which makes them exact after the final cast.
+struct Extrapolator {
+    using Weights = std::vector<uint64_t>;
+    std::vector<Weights> nextWeights{};
+    std::vector<Weights> prevWeights{};
+
+    explicit Extrapolator(const size_t maxLength) {
+        Weights binomial{1};
+        for (const auto n : iota(0uz, maxLength + 1)) {
+            Weights next(n);
+            Weights prev(n);
+            for (const auto i : iota(0uz, n)) {
+                next[i] = (n - 1 - i) % 2 == 0 ? binomial[i] : 0 - binomial[i];
+                prev[i] = i % 2 == 0 ? binomial[i + 1] : 0 - binomial[i + 1];
+            }
+            nextWeights.push_back(std::move(next));
+            prevWeights.push_back(std::move(prev));
+            // binomial row n+1
+            binomial.push_back(0);
+            for (const auto i : iota(1uz, binomial.size()) | std::views::reverse) {
+                binomial[i] += binomial[i - 1];
+            }
+        }
+    }
+
+    // next and previous value in one pass over the row
+    std::pair<int64_t, int64_t> operator()(const Seq &data) const {
+        const auto &next = nextWeights[data.size()];
+        const auto &prev = prevWeights[data.size()];
+        uint64_t nextValue = 0;
+        uint64_t prevValue = 0;
+        for (const auto i : iota(0uz, data.size())) {
+            nextValue += next[i] * static_cast<uint64_t>(data[i]);
+            prevValue += prev[i] * static_cast<uint64_t>(data[i]);
+        }
+        return {static_cast<int64_t>(nextValue), static_cast<int64_t>(prevValue)};
+    }
+};
+
+__extension__ using int128 = __int128;
+
+// Equal length rows in one contiguous matrix. Rows are stored in groups of
+// `lanes`, column by column inside a group, so each column of a group fills
+// one vector register and the difference table runs on all its rows at once.
+struct OasisMatrix {
+    static constexpr size_t lanes = 8;
+    size_t length{};
+    size_t rows{};
+    std::vector<int64_t> values{};
+
+    static std::optional<OasisMatrix> read(const char *filename) {
+        OasisMatrix matrix{};
+        std::ifstream infile{filename};
+        std::string line;
+        Seq row{};
+        while (std::getline(infile, line)) {
+            parseRow(line, row);
+            if (matrix.rows == 0) {
+                matrix.length = row.size();
+            } else if (row.size() != matrix.length) {
+                return {};
+            }
+            matrix.push(row);
         }
-        delta.push_back(value);
+        return matrix;
     }
-    if (allZero) {
-        return data[0];
-    } else {
-        const auto value = data.back() + nextValue(delta);
-        return value;
+
+    void push(const Seq &row) {
+        if (rows % lanes == 0) {
+            values.resize(values.size() + length * lanes, 0);
+        }
+        auto *const group = values.data() + rows / lanes * length * lanes;
+        for (const auto i : iota(0uz, length)) {
+            group[i * lanes + rows % lanes] = row[i];
+        }
+        ++rows;
     }
+
+    size_t groups() const { return (rows + lanes - 1) / lanes; }
+
+    // Next and previous value sums of one row group. The difference table is
+    // built in place, level by level: the next value is the sum of the last
+    // entries of all levels, the previous one their alternating sum of the
+    // first entries. Values of level k are bounded by 2^k times the largest
+    // input, groups that might overflow 64 bits use 128 bit rows instead.
+    std::pair<int128, int128> extrapolateGroup(const size_t groupId) {
+        auto *const group = values.data() + groupId * length * lanes;
+        uint64_t maxAbs = 0;
+        for (const auto i : iota(0uz, length * lanes)) {
+            maxAbs = std::max(maxAbs, group[i] < 0 ? 0 - static_cast<uint64_t>(group[i])
+                                                   : static_cast<uint64_t>(group[i]));
+        }
+        if (static_cast<size_t>(std::bit_width(maxAbs)) + length > 62) {
+            return extrapolateGroupWide(group);
+        }
+
+        std::array<int64_t, lanes> next{};
+        std::array<int64_t, lanes> prev{};
+        int64_t sign = 1;
+        for (const auto level : iota(0uz, length)) {
+            const auto last = length - 1 - level;
+            for (const auto lane : iota(0uz, lanes)) {
+                next[lane] += group[last * lanes + lane];
+                prev[lane] += sign * group[lane];
+            }
+            for (const auto i : iota(0uz, last)) {
+                for (const auto lane : iota(0uz, lanes)) {
+                    group[i * lanes + lane] =
+                        group[(i + 1) * lanes + lane] - group[i * lanes + lane];
+                }
+            }
+            sign = -sign;
+        }
+        return {std::reduce(next.begin(), next.end(), int128{0}),
+                std::reduce(prev.begin(), prev.end(), int128{0})};
+    }
+
+    std::pair<int128, int128> extrapolateGroupWide(const int64_t *const group) const {
+        int128 next = 0;
+        int128 prev = 0;
+        std::vector<int128> row(length);
+        for (const auto lane : iota(0uz, lanes)) {
+            for (const auto i : iota(0uz, length)) {
+                row[i] = group[i * lanes + lane];
+            }
+            int128 sign = 1;
+            for (const auto level : iota(0uz, length)) {
+                const auto last = length - 1 - level;
+                next += row[last];
+                prev += sign * row[0];
+                for (const auto i : iota(0uz, last)) {
+                    row[i] = row[i + 1] - row[i];
+                }
+                sign = -sign;
+            }
+        }
+        return {next, prev};
+    }
+};
+
+// Rows are parsed in batches and extrapolated right away. While the workers
+// process one batch the next one is parsed, and only these two batches are
+// ever kept in memory, whatever the size of the input.
+void streamOasis(const char *filename) {
+    constexpr size_t batchSize = 4096;
+    std::ifstream infile{filename};
+    std::string line;
+    Extrapolator extrapolate{0};
+    std::pair<int64_t, int64_t> sums{0, 0};
+    std::future<std::pair<int64_t, int64_t>> pending{};
+    const auto collect = [&sums, &pending] {
+        if (pending.valid()) {
+            const auto [nextSum, prevSum] = pending.get();
+            sums.first += nextSum;
+            sums.second += prevSum;
+        }
+    };
+
+    bool more = true;
+    while (more) {
+        std::vector<Seq> batch(batchSize);
+        size_t rows = 0;
+        size_t maxLength = 0;
+        while (rows < batchSize and (more = static_cast<bool>(std::getline(infile, line)))) {
+            parseRow(line, batch[rows]);
+            maxLength = std::max(maxLength, batch[rows].size());
+            ++rows;
+        }
+        batch.resize(rows);
+
+        collect();
+        if (maxLength >= extrapolate.nextWeights.size()) {
+            extrapolate = Extrapolator{maxLength};
+        }
+        pending = std::async(std::launch::async, [&extrapolate, batch = std::move(batch)] {
+            return std::transform_reduce(
+                std::execution::par_unseq, batch.begin(), batch.end(),
+                std::pair<int64_t, int64_t>{0, 0},
+                [](const auto &a, const auto &b) {
+                    return std::pair{a.first + b.first, a.second + b.second};
+                },
+                extrapolate);
+        });
+    }
+    collect();
+    fmt::print("Extrapolated next sum = {}\n", sums.first);
+    fmt::print("Extrapolated prev sum = {}\n", sums.second);
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [columnar|stream]\n";
         std::exit(EXIT_FAILURE);
     }
+    const std::string mode = argc == 3 ? argv[2] : "";
+
+    if (mode == "stream") {
+        streamOasis(argv[1]);
+        return 0;
+    }
+    if (mode == "columnar") {
+        auto matrix = OasisMatrix::read(argv[1]);
+        if (matrix) {
+            std::vector<size_t> groupIds(matrix->groups());
+            std::iota(groupIds.begin(), groupIds.end(), 0);
+            const auto [nextSum, prevSum] = std::transform_reduce(
+                std::execution::par, groupIds.begin(), groupIds.end(),
+                std::pair<int128, int128>{0, 0},
+                [](const auto &a, const auto &b) {
+                    return std::pair{a.first + b.first, a.second + b.second};
+                },
+                [&matrix](const size_t groupId) { return matrix->extrapolateGroup(groupId); });
+            fmt::print("Extrapolated next sum = {}\n", nextSum);
+            fmt::print("Extrapolated prev sum = {}\n", prevSum);
+            return 0;
+        }
+        fmt::print("Rows differ in length, columnar mode needs equal rows\n");
+    }
 
     SimpleParser scan{argv[1]};
     while (!scan.isEof()) {
         OASIS.push_back(readDataLine(scan));
     }
 
-    int64_t expSum = 0;
+    size_t maxLength = 0;
     for (const auto &seq : OASIS) {
-        const auto value = nextValue(seq);
-        expSum += value;
+        maxLength = std::max(maxLength, seq.size());
     }
-    fmt::print("Extrapolated next sum = {}\n", expSum);
+    const Extrapolator extrapolate{maxLength};
 
-    expSum = 0;
-    for (auto &seq : OASIS) {
-        std::reverse(seq.begin(), seq.end());
-        const auto value = nextValue(seq);
-        expSum += value;
-    }
-    fmt::print("Extrapolated prev sum = {}\n", expSum);
+    const auto [nextSum, prevSum] = std::transform_reduce(
+        std::execution::par_unseq, OASIS.begin(), OASIS.end(), std::pair<int64_t, int64_t>{0, 0},
+        [](const auto &a, const auto &b) {
+            return std::pair{a.first + b.first, a.second + b.second};
+        },
+        extrapolate);
+    fmt::print("Extrapolated next sum = {}\n", nextSum);
+    fmt::print("Extrapolated prev sum = {}\n", prevSum);
 }
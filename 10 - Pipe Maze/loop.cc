@@ -1,10 +1,17 @@
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <execution>
 #include <fmt/format.h>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <ranges>
+#include <span>
 #include <string>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "grid.hpp"
@@ -12,6 +19,9 @@
 
 using std::views::iota;
 
+// neighbour offsets in N, E, S, W order
+constexpr std::array<Vec2l, 4> directions{Vec2l{0, -1}, Vec2l{1, 0}, Vec2l{0, 1}, Vec2l{-1, 0}};
+
 Vec2l findAnimal(const auto &grid) {
     for (const auto y : iota(0, grid.height)) {
         for (const auto x : iota(0, grid.width)) {
@@ -24,111 +34,224 @@ Vec2l findAnimal(const auto &grid) {
     return {-1, -1};
 }
 
-bool connectsTo(const auto &grid, const Vec2l &src, const Vec2l &dst) {
-    const auto diff = src - dst;
-    const Vec2l north = neighbours4[1];
-    const Vec2l south = neighbours4[3];
-    const Vec2l east = neighbours4[0];
-    const Vec2l west = neighbours4[2];
-    switch (grid[dst]) {
-    case '|':
-        return diff == north or diff == south;
-    case '-':
-        return diff == east or diff == west;
-    case 'L':
-        return diff == north or diff == east;
-    case 'J':
-        return diff == north or diff == west;
-    case '7':
-        return diff == south or diff == west;
-    case 'F':
-        return diff == south or diff == east;
-    }
-    return false;
-}
+// connection bits of a tile, in clockwise order
+constexpr uint8_t north = 1;
+constexpr uint8_t east = 2;
+constexpr uint8_t south = 4;
+constexpr uint8_t west = 8;
 
-bool connected(const auto &grid, const Vec2l &a, const Vec2l &b) {
-    return connectsTo(grid, a, b) and connectsTo(grid, b, a);
-}
+constexpr auto pipeMasks = [] {
+    std::array<uint8_t, 256> masks{};
+    masks['|'] = north | south;
+    masks['-'] = east | west;
+    masks['L'] = north | east;
+    masks['J'] = north | west;
+    masks['7'] = south | west;
+    masks['F'] = south | east;
+    return masks;
+}();
 
-void replaceAnimalWithPipe(auto &grid, const Vec2l &src, const Vec2l &dst1, const Vec2l &dst2) {
+constexpr char pipeFor(const uint8_t mask) {
     for (const auto pipe : {'|', '-', 'L', 'J', '7', 'F'}) {
-        grid[src] = pipe;
-        if (connected(grid, src, dst1) and connected(grid, src, dst2)) {
-            return;
+        if (pipeMasks[static_cast<uint8_t>(pipe)] == mask) {
+            return pipe;
         }
     }
+    return '.';
 }
 
-int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
-        std::exit(EXIT_FAILURE);
+// directions are numbered like the mask bits: 0=N, 1=E, 2=S, 3=W
+constexpr int opposite(const int dir) { return (dir + 2) % 4; }
+
+// exitDir[mask][dir]: the direction we leave a tile after entering it moving in dir
+constexpr auto exitDir = [] {
+    std::array<std::array<int8_t, 4>, 16> table{};
+    for (const auto mask : iota(0, 16)) {
+        for (const auto dir : iota(0, 4)) {
+            const auto out = static_cast<unsigned>(mask & ~(1 << opposite(dir)));
+            table[mask][dir] = static_cast<int8_t>(out == 0 ? -1 : std::countr_zero(out));
+        }
     }
+    return table;
+}();
 
-    Grid<char> pipes1{argv[1], '.'};
+// one bit per tile, rows padded to whole words
+struct Bitmap {
+    int64_t width{};
+    int64_t height{};
+    size_t wordsPerRow{};
+    std::vector<uint64_t> words{};
 
-    std::unordered_set<Vec2l> visited1;
-    Vec2l animal = findAnimal(pipes1);
-    fmt::print("Animal starts at {}\n", animal);
-    visited1.insert(animal);
-    std::vector<Vec2l> positions{};
-    for (const auto diff : neighbours4) {
-        const auto dst = animal + diff;
-        if (connectsTo(pipes1, animal, dst)) {
-            positions.push_back(dst);
+    Bitmap(const int64_t width, const int64_t height)
+        : width{width}, height{height}, wordsPerRow{static_cast<size_t>(width + 63) / 64},
+          words(wordsPerRow * static_cast<size_t>(height)) {}
+
+    void set(const int64_t x, const int64_t y) {
+        words[static_cast<size_t>(y) * wordsPerRow + static_cast<size_t>(x) / 64] |=
+            uint64_t{1} << (x % 64);
+    }
+    bool test(const int64_t x, const int64_t y) const {
+        return (words[static_cast<size_t>(y) * wordsPerRow + static_cast<size_t>(x) / 64] >>
+                (x % 64)) &
+               1;
+    }
+    std::span<const uint64_t> row(const int64_t y) const {
+        return {words.data() + static_cast<size_t>(y) * wordsPerRow, wordsPerRow};
+    }
+};
+
+struct PipeLoop {
+    Bitmap tiles;
+    Bitmap crossings; // loop tiles with a pipe going north
+    int64_t length{};
+    Vec2l farthest{};
+    int64_t doubleArea{}; // shoelace sum over the tile centres, sign depends on direction
+};
+
+// Follows the pipes from the animal, leaving it towards `from`, and tells whether the walk
+// comes back into the animal's tile through its `to` side.
+bool closesLoop(const Grid<char> &grid, const Vec2l &animal, const int from, const int to) {
+    Vec2l pos = animal;
+    int dir = from;
+    for ([[maybe_unused]] const auto step : iota(0, grid.width * grid.height)) {
+        pos += directions[dir];
+        if (pos == animal) {
+            return dir == opposite(to);
         }
+        const auto mask = pipeMasks[static_cast<uint8_t>(grid[pos])];
+        if (!(mask & (1 << opposite(dir)))) {
+            return false;
+        }
+        dir = exitDir[mask][dir];
     }
-    replaceAnimalWithPipe(pipes1, animal, positions[0], positions[1]);
-
-    int64_t steps = 1;
-    while (positions[0] != positions[1]) {
-        for (auto &pos : positions) {
-            visited1.insert(pos);
-            for (const auto diff : neighbours4) {
-                const auto next = pos + diff;
-                if (!visited1.contains(next) and connected(pipes1, pos, next)) {
-                    pos = next;
-                    break;
-                }
+    return false;
+}
+
+// The animal's tile gets the pipe that connects to two of its neighbours. If more than two
+// neighbours point at the animal, the pair that closes the loop wins. Returns 0 if there
+// is no such pair.
+uint8_t animalMask(const Grid<char> &grid, const Vec2l &animal) {
+    uint8_t candidates = 0;
+    for (const auto dir : iota(0, 4)) {
+        const auto next = animal + directions[dir];
+        if (pipeMasks[static_cast<uint8_t>(grid[next])] & (1 << opposite(dir))) {
+            candidates |= static_cast<uint8_t>(1 << dir);
+        }
+    }
+    for (const auto from : iota(0, 4)) {
+        for (const auto to : iota(from + 1, 4)) {
+            const auto mask = static_cast<uint8_t>((1 << from) | (1 << to));
+            if ((candidates & mask) == mask and closesLoop(grid, animal, from, to)) {
+                return mask;
             }
         }
-        ++steps;
     }
-    visited1.insert(positions[0]);
-    fmt::print("The farthest point from the animal is {} after {} steps.\n", positions[0], steps);
+    return 0;
+}
+
+// Walks the loop from the animal in both directions at once, until both walkers meet on
+// the farthest tile. Each step is a single table lookup on the flat grid data. The second
+// walker runs against the loop direction, so its shoelace terms count negative.
+PipeLoop traceLoop(const Grid<char> &grid, const Vec2l &animal) {
+    PipeLoop loop{Bitmap{grid.width, grid.height}, Bitmap{grid.width, grid.height}};
+    const std::array<int64_t, 4> offsets{-grid.width, 1, grid.width, -1};
+    const auto mask = pipeMasks[static_cast<uint8_t>(grid[animal])];
+    std::array<int, 2> dirs{std::countr_zero(mask), 7 - std::countl_zero(mask)};
+    std::array<int64_t, 2> positions{animal.y * grid.width + animal.x,
+                                     animal.y * grid.width + animal.x};
+    std::array<Vec2l, 2> previous{animal, animal};
+    loop.tiles.set(animal.x, animal.y);
+    if (mask & north) {
+        loop.crossings.set(animal.x, animal.y);
+    }
+
+    do {
+        for (const auto walker : {0, 1}) {
+            auto &pos = positions[walker];
+            auto &dir = dirs[walker];
+            pos += offsets[dir];
+            const Vec2l tile{pos % grid.width, pos / grid.width};
+            loop.tiles.set(tile.x, tile.y);
+            const auto cross = previous[walker].x * tile.y - tile.x * previous[walker].y;
+            loop.doubleArea += walker == 0 ? cross : -cross;
+            previous[walker] = tile;
+            const auto tileMask =
+                pipeMasks[static_cast<uint8_t>(grid.data[static_cast<size_t>(pos)])];
+            if (tileMask & north) {
+                loop.crossings.set(tile.x, tile.y);
+            }
+            dir = exitDir[tileMask][dir];
+        }
+        loop.length += 2;
+    } while (positions[0] != positions[1]);
+
+    loop.farthest = {positions[0] % grid.width, positions[0] / grid.width};
+    return loop;
+}
+
+// Pick's theorem: A = I + L/2 - 1, with the area A from the shoelace formula.
+std::pair<int64_t, int64_t> pickInside(const Grid<char> &grid, const PipeLoop &loop) {
+    const auto inside = std::abs(loop.doubleArea) / 2 - loop.length / 2 + 1;
+    return {inside, grid.width * grid.height - loop.length - inside};
+}
+
+// Parity scan: a tile is inside if an odd number of loop pipes going north lie to its left.
+// Rows are independent and scanned in parallel. Within a row a prefix XOR turns the crossing
+// bits of a word into the parity at each tile, and the parity of the last bit carries over
+// into the next word.
+std::pair<int64_t, int64_t> scanInside(const Grid<char> &grid, const PipeLoop &loop) {
+    std::vector<int64_t> rows(static_cast<size_t>(grid.height));
+    std::iota(rows.begin(), rows.end(), 0);
+    const auto lastBits = grid.width % 64;
+    const uint64_t lastMask = lastBits == 0 ? ~uint64_t{0} : (uint64_t{1} << lastBits) - 1;
 
-    Grid<char> nest{pipes1.width, pipes1.height, '.'};
-    int64_t inside = 0;
-    int64_t outside = 0;
+    return std::transform_reduce(
+        std::execution::par, rows.begin(), rows.end(), std::pair<int64_t, int64_t>{0, 0},
+        [](const auto &a, const auto &b) {
+            return std::pair{a.first + b.first, a.second + b.second};
+        },
+        [&](const int64_t y) {
+            const auto tiles = loop.tiles.row(y);
+            const auto crossings = loop.crossings.row(y);
+            int64_t inside = 0;
+            int64_t outside = 0;
+            uint64_t carry = 0;
+            for (const auto w : iota(size_t{0}, tiles.size())) {
+                auto parity = crossings[w];
+                for (const auto shift : {1, 2, 4, 8, 16, 32}) {
+                    parity ^= parity << shift;
+                }
+                parity ^= carry;
+                carry = uint64_t{0} - (parity >> 63);
+                const auto free = ~tiles[w] & (w + 1 == tiles.size() ? lastMask : ~uint64_t{0});
+                inside += std::popcount(free & parity);
+                outside += std::popcount(free & ~parity);
+            }
+            return std::pair<int64_t, int64_t>{inside, outside};
+        });
+}
+
+// draws the loop with box characters and shades the inside tiles
+void render(const Grid<char> &pipes, const PipeLoop &loop, const Vec2l &animal) {
+    Grid<char> nest{pipes.width, pipes.height, '.'};
     bool isInside = false;
 
-    for (const auto y : iota(0, pipes1.height)) {
-        for (const auto x : iota(0, pipes1.width)) {
+    for (const auto y : iota(0, pipes.height)) {
+        for (const auto x : iota(0, pipes.width)) {
             const Vec2l pos{x, y};
-            if (visited1.contains(pos)) {
-                switch (pipes1[pos]) {
-                case '|':
-                case 'L':
-                case 'J':
+            if (loop.tiles.test(x, y)) {
+                if (pipeMasks[static_cast<uint8_t>(pipes[pos])] & north) {
                     isInside = !isInside;
-                    break;
                 }
-                nest[pos] = pipes1[pos];
+                nest[pos] = pipes[pos];
             } else if (isInside) {
-                ++inside;
                 nest[pos] = 'I';
-            } else {
-                ++outside;
-                nest[pos] = '.';
             }
         }
     }
-    fmt::print("There are {} tiles inside the loop and {} outside\n", inside, outside);
-
     nest[animal] = 'S';
-    for (const auto y : iota(0, pipes1.height)) {
-        for (const auto x : iota(0, pipes1.width)) {
+    for (const auto y : iota(0, pipes.height)) {
+        for (const auto x : iota(0, pipes.width)) {
             const Vec2l pos{x, y};
             switch (nest[pos]) {
             case '|':
@@ -166,3 +289,35 @@ int main(int argc, char **argv) {
         std::cout << '\n';
     }
 }
+
+int main(int argc, char **argv) {
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [scan|render]\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    const std::string mode = argc == 3 ? argv[2] : "";
+
+    Grid<char> pipes1{argv[1], '.'};
+
+    const Vec2l animal = findAnimal(pipes1);
+    fmt::print("Animal starts at {}\n", animal);
+    const auto mask = animalMask(pipes1, animal);
+    if (mask == 0) {
+        fmt::print("No loop runs through the animal\n");
+        std::exit(EXIT_FAILURE);
+    }
+    pipes1[animal] = pipeFor(mask);
+
+    const auto loop = traceLoop(pipes1, animal);
+    fmt::print("The farthest point from the animal is {} after {} steps.\n", loop.farthest,
+               loop.length / 2);
+
+    const auto [inside, outside] =
+        mode == "scan" ? scanInside(pipes1, loop) : pickInside(pipes1, loop);
+    fmt::print("There are {} tiles inside the loop and {} outside\n", inside, outside);
+
+    if (mode == "render") {
+        render(pipes1, loop, animal);
+    }
+}
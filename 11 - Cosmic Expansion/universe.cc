@@ -2,6 +2,7 @@
 #include <fmt/format.h>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <ranges>
 #include <string>
 #include <vector>
@@ -11,53 +12,72 @@
 
 using std::views::iota;
 
-int64_t distSum(auto &positions, const int64_t expansion = 2) {
-    int64_t sum = 0;
-    int64_t openDist = 0;
-    auto it = positions.begin();
-    auto current = *it;
-    int64_t count = 1;
+__extension__ using int128 = __int128;
 
-    while (++it != positions.end()) {
-        const auto next = *it;
+// Every pair of galaxies a < b steps across the coordinates (a, b], so coordinate c is crossed
+// before(c) * (n - before(c)) times, and each crossing counts as the expansion if c is empty.
+// The crossings are summed once, split by empty and occupied coordinates, and any expansion
+// is then a single multiply-add.
+struct Expansion {
+    int128 crossings{};      // all crossings, i.e. the distance sum without expansion
+    int128 emptyCrossings{}; // crossings of empty rows and columns
 
-        if (next > current) {
-            const auto distToPrev = (next - current - 1) * expansion + 1;
-            openDist += count * distToPrev;
+    Expansion(const std::vector<int64_t> &columns, const std::vector<int64_t> &rows) {
+        add(columns);
+        add(rows);
+    }
+
+    int128 operator()(const int64_t factor) const {
+        return crossings + (factor - 1) * emptyCrossings;
+    }
+
+  private:
+    void add(const std::vector<int64_t> &counts) {
+        const auto galaxies = std::reduce(counts.begin(), counts.end());
+        int64_t before = 0;
+        for (const auto count : counts) {
+            const int128 pairs = int128{before} * (galaxies - before);
+            crossings += pairs;
+            if (count == 0) {
+                emptyCrossings += pairs;
+            }
+            before += count;
         }
-        sum += openDist;
-        ++count;
-        current = next;
     }
-    return sum;
-}
+};
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.txt>\n";
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> [factor...]\n";
         std::exit(EXIT_FAILURE);
     }
 
+    // galaxies per column and per row
     std::vector<int64_t> x;
     std::vector<int64_t> y;
 
     std::ifstream infile{argv[1]};
     std::string line;
-    int64_t yPos = 0;
     while (std::getline(infile, line)) {
+        x.resize(std::max(x.size(), line.size()));
+        y.push_back(0);
         for (auto xPos = line.find('#', 0); xPos != std::string::npos;
              xPos = line.find('#', xPos + 1)) {
-            x.push_back(xPos);
-            y.push_back(yPos);
+            ++x[xPos];
+            ++y.back();
+        }
+    }
+
+    std::vector<int64_t> factors{2, 10, 100, 1'000'000};
+    if (argc > 2) {
+        factors.clear();
+        for (const auto arg : iota(2, argc)) {
+            factors.push_back(std::stoll(argv[arg]));
         }
-        ++yPos;
     }
-    std::ranges::sort(x);
-    std::ranges::sort(y);
 
-    for (const auto e : {2, 10, 100, 1'000'000}) {
-        const auto xDistSum = distSum(x, e);
-        const auto yDistSum = distSum(y, e);
-        fmt::print("The x{} sum of all paths is {}\n", e, xDistSum + yDistSum);
+    const Expansion expansion{x, y};
+    for (const auto factor : factors) {
+        fmt::print("The x{} sum of all paths is {}\n", factor, expansion(factor));
     }
 }